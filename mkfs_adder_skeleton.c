@@ -1,5 +1,6 @@
 // Build: gcc -O2 -std=c17 -Wall -Wextra mkfs_adder_skeleton.c -o mkfs_adder
 #define _FILE_OFFSET_BITS 64
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -8,12 +9,19 @@
 #include <errno.h>
 #include <time.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <getopt.h>
 
 #define BS 4096u
 #define INODE_SIZE 128u
 #define ROOT_INO 1u
 #define DIRECT_MAX 12
+#define MAX_FILES 64             // root directory holds BS / sizeof(dirent64_t) entries
+#define MAX_DIRTY (MAX_FILES * (DIRECT_MAX + 4) + 8)
+#define JOURNAL_DESC_MAGIC 0x4D564A44u    // "MVJD"
+#define JOURNAL_COMMIT_MAGIC 0x4D564A43u  // "MVJC"
+#define JOURNAL_MAX_TARGETS ((BS - 24) / 8)
+#define JOURNAL_MIN_BLOCKS 8
 #pragma pack(push, 1)
 
 typedef struct {
@@ -34,9 +42,11 @@ typedef struct {
     uint64_t mtime_epoch;        // Build time
     uint32_t flags;              // 0
     uint32_t checksum;           // crc32(superblock[0..4091])
+    uint64_t journal_start;      // first journal block, 0 if none
+    uint64_t journal_blocks;     // 0 if none
 } superblock_t;
 #pragma pack(pop)
-_Static_assert(sizeof(superblock_t) == 116, "superblock must fit in one block");
+_Static_assert(sizeof(superblock_t) == 132, "superblock must fit in one block");
 
 #pragma pack(push,1)
 typedef struct {
@@ -70,6 +80,33 @@ typedef struct {
 #pragma pack(pop)
 _Static_assert(sizeof(dirent64_t)==64, "dirent size mismatch");
 
+// Journal layout (journal_start .. journal_start + journal_blocks - 1):
+//   block 0           journal_desc_t for the live transaction
+//   blocks 1..n       copies of the n logged metadata blocks
+//   block n + 1       journal_commit_t
+// Data blocks are not logged; they are written in place before the commit and
+// listed after the logged targets so the commit checksum covers them too.
+#pragma pack(push,1)
+typedef struct {
+    uint32_t magic;              // JOURNAL_DESC_MAGIC while live, 0 once checkpointed
+    uint32_t logged_count;       // metadata blocks copied into the journal
+    uint32_t data_count;         // data blocks written in place
+    uint32_t reserved;
+    uint64_t sequence;
+    uint64_t targets[JOURNAL_MAX_TARGETS]; // home blocks: logged first, then data
+} journal_desc_t;
+#pragma pack(pop)
+_Static_assert(sizeof(journal_desc_t)==BS, "journal descriptor size mismatch");
+
+#pragma pack(push,1)
+typedef struct {
+    uint32_t magic;              // JOURNAL_COMMIT_MAGIC
+    uint32_t crc;                // see journal_txn_crc()
+    uint64_t sequence;           // must match the descriptor
+} journal_commit_t;
+#pragma pack(pop)
+_Static_assert(sizeof(journal_commit_t)==16, "journal commit size mismatch");
+
 
 // ==========================DO NOT CHANGE THIS PORTION=========================
 // These functions are there for your help. You should refer to the specifications to see how you can use them.
@@ -115,7 +152,8 @@ void dirent_checksum_finalize(dirent64_t* de) {
 }
 
 void print_usage(const char* prog_name) {
-    fprintf(stderr, "Usage: %s --input <input_image> --output <output_image> --file <filename>\n", prog_name);
+    fprintf(stderr, "Usage: %s --input <input_image> --output <output_image> --file <filename> [--file <filename> ...]\n", prog_name);
+    fprintf(stderr, "       %s --image <image> [--file <filename> ...]\n", prog_name);
 }
 
 uint32_t find_first_free_bit(uint8_t *bitmap, uint32_t bitmap_size, uint32_t max_items) {
@@ -135,48 +173,241 @@ void set_bit(uint8_t *bitmap, uint32_t bit_index) {
     bitmap[byte_index] |= (1 << bit_offset);
 }
 
-int main(int argc, char *argv[]) {
-    crc32_init();
-    
-    char *input_name = NULL;
-    char *output_name = NULL;
-    char *file_name = NULL;
-    
-    struct option long_options[] = {
-        {"input", required_argument, 0, 'i'},
-        {"output", required_argument, 0, 'o'},
-        {"file", required_argument, 0, 'f'},
-        {0, 0, 0, 0}
-    };
-    
-    int opt;
-    while ((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
-        switch (opt) {
-            case 'i':
-                input_name = optarg;
-                break;
-            case 'o':
-                output_name = optarg;
-                break;
-            case 'f':
-                file_name = optarg;
-                break;
-            default:
-                print_usage(argv[0]);
-                return 1;
+// Block numbers touched by one batch of adds, without duplicates.
+typedef struct {
+    uint64_t blocks[MAX_DIRTY];
+    uint32_t count;
+} block_set_t;
+
+static void mark_dirty(block_set_t *set, uint64_t block) {
+    for (uint32_t i = 0; i < set->count; i++) {
+        if (set->blocks[i] == block) {
+            return;
         }
     }
-    
-    if (!input_name || !output_name || !file_name) {
-        fprintf(stderr, "Error: Missing required arguments\n");
-        print_usage(argv[0]);
+    if (set->count < MAX_DIRTY) {
+        set->blocks[set->count++] = block;
+    }
+}
+
+static int write_block(FILE *fp, uint64_t block, const uint8_t *buf) {
+    if (fseeko(fp, (off_t)(block * BS), SEEK_SET) != 0 || fwrite(buf, 1, BS, fp) != BS) {
+        fprintf(stderr, "Error writing block %llu: %s\n", (unsigned long long)block, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static int read_block(FILE *fp, uint64_t block, uint8_t *buf) {
+    if (fseeko(fp, (off_t)(block * BS), SEEK_SET) != 0 || fread(buf, 1, BS, fp) != BS) {
+        fprintf(stderr, "Error reading block %llu\n", (unsigned long long)block);
+        return -1;
+    }
+    return 0;
+}
+
+static int sync_image(FILE *fp) {
+    if (fflush(fp) != 0 || fsync(fileno(fp)) != 0) {
+        fprintf(stderr, "Error syncing image: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// Marks the descriptor checkpointed. Once this is on disk the transaction will
+// never be replayed again, so later in-place writers cannot be overwritten.
+static int journal_clear(FILE *fp, const superblock_t *sb, journal_desc_t *desc) {
+    (*desc).magic = 0;
+    if (write_block(fp, sb->journal_start, (const uint8_t *)desc) != 0) {
+        return -1;
+    }
+    return sync_image(fp);
+}
+
+// Transaction checksum: crc32 over the crc32 of each block it covers, in order
+// (descriptor, logged metadata blocks, in-place data blocks).
+static uint32_t journal_txn_crc(const uint32_t *block_crcs, uint32_t n) {
+    return crc32(block_crcs, (size_t)n * sizeof(uint32_t));
+}
+
+// The journal must be absent (both fields 0) or lie between the inode table
+// and the data region, with room for a descriptor, a commit record and the
+// logged blocks. Checked on open, before any journal block is read.
+static int journal_geometry_valid(const superblock_t *sb) {
+    if (sb->journal_start == 0 && sb->journal_blocks == 0) {
         return 1;
     }
-    
+    return sb->journal_blocks >= JOURNAL_MIN_BLOCKS &&
+           sb->journal_start >= sb->inode_table_start + sb->inode_table_blocks &&
+           sb->journal_start <= sb->data_region_start &&
+           sb->journal_blocks <= sb->data_region_start - sb->journal_start &&
+           sb->data_region_start <= sb->total_blocks;
+}
+
+// Replays a committed transaction left behind by an interrupted adder and
+// discards an uncommitted one. Must run before the image is read, on a
+// superblock that passed journal_geometry_valid(). Stores the
+// sequence number the next transaction should use in *next_seq.
+int journal_recover(FILE *fp, const superblock_t *sb, uint64_t *next_seq) {
+    journal_desc_t desc;
+    *next_seq = 1;
+    if (sb->journal_blocks == 0) {
+        return 0;
+    }
+    if (read_block(fp, sb->journal_start, (uint8_t *)&desc) != 0) {
+        return -1;
+    }
+    *next_seq = desc.sequence + 1;
+    if (desc.magic != JOURNAL_DESC_MAGIC) {
+        return 0;
+    }
+
+    uint64_t capacity = sb->journal_blocks - 2;
+    int committed = desc.logged_count <= capacity &&
+                    (uint64_t)desc.logged_count + desc.data_count <= JOURNAL_MAX_TARGETS;
+
+    uint8_t *logged = NULL;
+    uint32_t *crcs = NULL;
+    if (committed) {
+        logged = malloc(((size_t)desc.logged_count + 1) * BS);
+        crcs = malloc(((size_t)desc.logged_count + desc.data_count + 1) * sizeof(uint32_t));
+        if (!logged || !crcs) {
+            fprintf(stderr, "Error: Cannot allocate memory for journal recovery\n");
+            free(logged);
+            free(crcs);
+            return -1;
+        }
+        // logged blocks followed by the commit record
+        for (uint32_t i = 0; i <= desc.logged_count; i++) {
+            if (read_block(fp, sb->journal_start + 1 + i, logged + (size_t)i * BS) != 0) {
+                free(logged);
+                free(crcs);
+                return -1;
+            }
+        }
+        journal_commit_t *commit = (journal_commit_t *)(logged + (size_t)desc.logged_count * BS);
+        committed = (*commit).magic == JOURNAL_COMMIT_MAGIC && (*commit).sequence == desc.sequence;
+
+        uint32_t n = 0;
+        crcs[n++] = crc32(&desc, BS);
+        for (uint32_t i = 0; i < desc.logged_count; i++) {
+            crcs[n++] = crc32(logged + (size_t)i * BS, BS);
+        }
+        uint8_t block[BS];
+        for (uint32_t i = 0; committed && i < desc.data_count; i++) {
+            uint64_t target = desc.targets[desc.logged_count + i];
+            if (target >= sb->total_blocks || read_block(fp, target, block) != 0) {
+                committed = 0;
+                break;
+            }
+            crcs[n++] = crc32(block, BS);
+        }
+        committed = committed && (*commit).crc == journal_txn_crc(crcs, n);
+    }
+
+    if (committed) {
+        for (uint32_t i = 0; i < desc.logged_count; i++) {
+            if (desc.targets[i] >= sb->total_blocks ||
+                write_block(fp, desc.targets[i], logged + (size_t)i * BS) != 0) {
+                free(logged);
+                free(crcs);
+                return -1;
+            }
+        }
+        if (sync_image(fp) != 0) {
+            free(logged);
+            free(crcs);
+            return -1;
+        }
+        printf("Journal: replayed transaction %llu (%u blocks)\n",
+               (unsigned long long)desc.sequence, desc.logged_count);
+    } else {
+        printf("Journal: discarded incomplete transaction %llu\n", (unsigned long long)desc.sequence);
+    }
+    free(logged);
+    free(crcs);
+    return journal_clear(fp, sb, &desc);
+}
+
+// Commits one transaction and checkpoints it in place:
+//   1. write data blocks home, then the descriptor and logged metadata blocks
+//      and the checksummed commit record into the journal; sync once
+//   2. write the metadata blocks home; sync
+//   3. clear the descriptor; sync
+// The commit record checksum covers every block written in step 1, so a crash
+// before that sync completes is detected on recovery and the add never happened.
+int journal_commit(FILE *fp, const uint8_t *fs_image, const superblock_t *sb, uint64_t seq,
+                   const block_set_t *meta, const block_set_t *data) {
+    if (meta->count > sb->journal_blocks - 2 ||
+        (uint64_t)meta->count + data->count > JOURNAL_MAX_TARGETS) {
+        fprintf(stderr, "Error: Too many changes for one journal transaction; add fewer files at once\n");
+        return -1;
+    }
+
+    journal_desc_t desc = {0};
+    desc.magic = JOURNAL_DESC_MAGIC;
+    desc.logged_count = meta->count;
+    desc.data_count = data->count;
+    desc.sequence = seq;
+    for (uint32_t i = 0; i < meta->count; i++) {
+        desc.targets[i] = meta->blocks[i];
+    }
+    for (uint32_t i = 0; i < data->count; i++) {
+        desc.targets[meta->count + i] = data->blocks[i];
+    }
+
+    uint32_t crcs[1 + MAX_DIRTY * 2];
+    uint32_t n = 0;
+    crcs[n++] = crc32(&desc, BS);
+    for (uint32_t i = 0; i < meta->count; i++) {
+        crcs[n++] = crc32(fs_image + meta->blocks[i] * BS, BS);
+    }
+    for (uint32_t i = 0; i < data->count; i++) {
+        crcs[n++] = crc32(fs_image + data->blocks[i] * BS, BS);
+    }
+
+    uint8_t block[BS] = {0};
+    journal_commit_t *commit = (journal_commit_t *)block;
+    (*commit).magic = JOURNAL_COMMIT_MAGIC;
+    (*commit).crc = journal_txn_crc(crcs, n);
+    (*commit).sequence = seq;
+
+    for (uint32_t i = 0; i < data->count; i++) {
+        if (write_block(fp, data->blocks[i], fs_image + data->blocks[i] * BS) != 0) {
+            return -1;
+        }
+    }
+    if (write_block(fp, sb->journal_start, (const uint8_t *)&desc) != 0) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < meta->count; i++) {
+        if (write_block(fp, sb->journal_start + 1 + i, fs_image + meta->blocks[i] * BS) != 0) {
+            return -1;
+        }
+    }
+    if (write_block(fp, sb->journal_start + 1 + meta->count, block) != 0 || sync_image(fp) != 0) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < meta->count; i++) {
+        if (write_block(fp, meta->blocks[i], fs_image + meta->blocks[i] * BS) != 0) {
+            return -1;
+        }
+    }
+    if (sync_image(fp) != 0) {
+        return -1;
+    }
+    return journal_clear(fp, sb, &desc);
+}
+
+// Adds one host file to the in-memory image and records every block it
+// changes: metadata blocks in meta, file data blocks in data.
+int add_file(uint8_t *fs_image, const superblock_t *sb, const char *file_name, time_t now,
+             block_set_t *meta, block_set_t *data) {
     FILE *file_fp = fopen(file_name, "rb");
     if (!file_fp) {
         fprintf(stderr, "Error: Cannot open file %s: %s\n", file_name, strerror(errno));
-        return 1;
+        return -1;
     }
     
     fseek(file_fp, 0, SEEK_END);
@@ -186,96 +417,50 @@ int main(int argc, char *argv[]) {
     if (file_size < 0) {
         fprintf(stderr, "Error: Cannot determine file size\n");
         fclose(file_fp);
-        return 1;
+        return -1;
     }
     
     uint64_t blocks_needed = (file_size + BS - 1) / BS;
     if (blocks_needed > DIRECT_MAX) {
         fprintf(stderr, "Error: File too large to fit in %d direct blocks\n", DIRECT_MAX);
         fclose(file_fp);
-        return 1;
-    }
-    
-    FILE *input_fp = fopen(input_name, "rb");
-    if (!input_fp) {
-        fprintf(stderr, "Error: Cannot open input image %s: %s\n", input_name, strerror(errno));
-        fclose(file_fp);
-        return 1;
-    }
-    
-    superblock_t sb;
-    if (fread(&sb, 1, sizeof(sb), input_fp) != sizeof(sb)) {
-        fprintf(stderr, "Error reading superblock\n");
-        fclose(file_fp);
-        fclose(input_fp);
-        return 1;
+        return -1;
     }
     
-    if (sb.magic != 0x4D565346) {
-        fprintf(stderr, "Error: Invalid filesystem magic number\n");
-        fclose(file_fp);
-        fclose(input_fp);
-        return 1;
-    }
-    
-    if (blocks_needed > sb.data_region_blocks) {
+    if (blocks_needed > sb->data_region_blocks) {
         fprintf(stderr, "Error: Not enough free data blocks\n");
         fclose(file_fp);
-        fclose(input_fp);
-        return 1;
+        return -1;
     }
     
-    fseek(input_fp, 0, SEEK_END);
-    long image_size = ftell(input_fp);
-    fseek(input_fp, 0, SEEK_SET);
+    uint8_t *inode_bitmap = fs_image + sb->inode_bitmap_start * BS;
+    uint8_t *data_bitmap = fs_image + sb->data_bitmap_start * BS;
+    uint8_t *inode_table = fs_image + sb->inode_table_start * BS;
+    uint8_t *data_region = fs_image + sb->data_region_start * BS;
     
-    uint8_t *fs_image = malloc(image_size);
-    if (!fs_image) {
-        fprintf(stderr, "Error: Cannot allocate memory for filesystem image\n");
-        fclose(file_fp);
-        fclose(input_fp);
-        return 1;
-    }
-    
-    if (fread(fs_image, 1, image_size, input_fp) != image_size) {
-        fprintf(stderr, "Error reading filesystem image\n");
-        free(fs_image);
-        fclose(file_fp);
-        fclose(input_fp);
-        return 1;
-    }
-    fclose(input_fp);
-    
-    uint8_t *inode_bitmap = fs_image + sb.inode_bitmap_start * BS;
-    uint8_t *data_bitmap = fs_image + sb.data_bitmap_start * BS;
-    uint8_t *inode_table = fs_image + sb.inode_table_start * BS;
-    uint8_t *data_region = fs_image + sb.data_region_start * BS;
-    
-    uint32_t new_inode_no = find_first_free_bit(inode_bitmap, BS, sb.inode_count);
+    uint32_t new_inode_no = find_first_free_bit(inode_bitmap, BS, sb->inode_count);
     if (new_inode_no == 0) {
         fprintf(stderr, "Error: No free inodes available\n");
-        free(fs_image);
         fclose(file_fp);
-        return 1;
+        return -1;
     }
     
     uint32_t data_blocks[DIRECT_MAX] = {0};
     uint32_t blocks_found = 0;
     
-    for (uint32_t i = 1; i <= sb.data_region_blocks && blocks_found < blocks_needed; i++) {
+    for (uint32_t i = 1; i <= sb->data_region_blocks && blocks_found < blocks_needed; i++) {
         uint32_t byte_idx = (i - 1) / 8;
         uint32_t bit_idx = (i - 1) % 8;
         if (!(data_bitmap[byte_idx] & (1 << bit_idx))) {
-            data_blocks[blocks_found] = sb.data_region_start + i - 1;
+            data_blocks[blocks_found] = sb->data_region_start + i - 1;
             blocks_found++;
         }
     }
     
     if (blocks_found < blocks_needed) {
         fprintf(stderr, "Error: Not enough free data blocks\n");
-        free(fs_image);
         fclose(file_fp);
-        return 1;
+        return -1;
     }
     
     inode_t new_inode = {0};
@@ -284,7 +469,6 @@ int main(int argc, char *argv[]) {
     new_inode.uid = 0;
     new_inode.gid = 0;
     new_inode.size_bytes = file_size;
-    time_t now = time(NULL);
     new_inode.atime = now;
     new_inode.mtime = now;
     new_inode.ctime = now;
@@ -310,29 +494,32 @@ int main(int argc, char *argv[]) {
         
         if (fread(block_data, 1, to_read, file_fp) != to_read) {
             fprintf(stderr, "Error reading file data\n");
-            free(fs_image);
             fclose(file_fp);
-            return 1;
+            return -1;
         }
         
         uint64_t block_offset = (data_blocks[i] * BS);
         memcpy(fs_image + block_offset, block_data, BS);
+        mark_dirty(data, data_blocks[i]);
     }
     fclose(file_fp);
     
     set_bit(inode_bitmap, new_inode_no);
     for (uint32_t i = 0; i < blocks_needed; i++) {
-        uint32_t data_block_idx = data_blocks[i] - sb.data_region_start + 1;
+        uint32_t data_block_idx = data_blocks[i] - sb->data_region_start + 1;
         set_bit(data_bitmap, data_block_idx);
     }
+    mark_dirty(meta, sb->inode_bitmap_start);
+    mark_dirty(meta, sb->data_bitmap_start);
     
     inode_crc_finalize(&new_inode);
     uint64_t inode_offset = (new_inode_no - 1) * INODE_SIZE;
     memcpy(inode_table + inode_offset, &new_inode, sizeof(new_inode));
+    mark_dirty(meta, sb->inode_table_start + inode_offset / BS);
     
     inode_t *root_inode = (inode_t *)inode_table;
     
-    uint8_t *root_dir_data = data_region + ((*root_inode).direct[0] - sb.data_region_start) * BS;
+    uint8_t *root_dir_data = data_region + ((*root_inode).direct[0] - sb->data_region_start) * BS;
     
     dirent64_t *entries = (dirent64_t *)root_dir_data;
     int entries_per_block = BS / sizeof(dirent64_t);
@@ -347,15 +534,14 @@ int main(int argc, char *argv[]) {
     
     if (free_entry == -1) {
         fprintf(stderr, "Error: No free directory entries in root directory\n");
-        free(fs_image);
-        return 1;
+        return -1;
     }
     
     dirent64_t new_entry = {0};
     new_entry.inode_no = new_inode_no;
     new_entry.type = 1; // file
     
-    char *basename = strrchr(file_name, '/');
+    const char *basename = strrchr(file_name, '/');
     if (basename) {
         basename++; 
     } else {
@@ -364,23 +550,211 @@ int main(int argc, char *argv[]) {
     
     if (strlen(basename) >= 58) {
         fprintf(stderr, "Error: Filename too long (max 57 characters)\n");
-        free(fs_image);
-        return 1;
+        return -1;
     }
     
     strcpy(new_entry.name, basename);
     dirent_checksum_finalize(&new_entry);
     
     memcpy(&entries[free_entry], &new_entry, sizeof(new_entry));
+    mark_dirty(meta, (*root_inode).direct[0]);
     
     (*root_inode).size_bytes += sizeof(dirent64_t);
     (*root_inode).links++; 
     (*root_inode).mtime = now;
     inode_crc_finalize(root_inode);
+    mark_dirty(meta, sb->inode_table_start);
+    
+    printf("File '%s' successfully added to filesystem\n", basename);
+    printf("Assigned inode number: %u\n", new_inode_no);
+    printf("File size: %ld bytes\n", file_size);
+    printf("Blocks used: %u\n", (uint32_t)blocks_needed);
+    
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    crc32_init();
+    
+    char *input_name = NULL;
+    char *output_name = NULL;
+    char *image_name = NULL;
+    char *file_names[MAX_FILES];
+    int file_count = 0;
+    
+    struct option long_options[] = {
+        {"input", required_argument, 0, 'i'},
+        {"output", required_argument, 0, 'o'},
+        {"image", required_argument, 0, 'm'},
+        {"file", required_argument, 0, 'f'},
+        {0, 0, 0, 0}
+    };
+    
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'i':
+                input_name = optarg;
+                break;
+            case 'o':
+                output_name = optarg;
+                break;
+            case 'm':
+                image_name = optarg;
+                break;
+            case 'f':
+                if (file_count == MAX_FILES) {
+                    fprintf(stderr, "Error: At most %d files can be added at once\n", MAX_FILES);
+                    return 1;
+                }
+                file_names[file_count++] = optarg;
+                break;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    
+    // --image updates in place through the journal; --input/--output rewrites a copy
+    int in_place = image_name != NULL;
+    if (in_place ? (input_name || output_name) : (!input_name || !output_name || file_count == 0)) {
+        fprintf(stderr, "Error: Missing required arguments\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+    
+    FILE *input_fp = fopen(in_place ? image_name : input_name, in_place ? "r+b" : "rb");
+    if (!input_fp) {
+        fprintf(stderr, "Error: Cannot open input image %s: %s\n",
+                in_place ? image_name : input_name, strerror(errno));
+        return 1;
+    }
+    
+    superblock_t sb;
+    if (fread(&sb, 1, sizeof(sb), input_fp) != sizeof(sb)) {
+        fprintf(stderr, "Error reading superblock\n");
+        fclose(input_fp);
+        return 1;
+    }
+    
+    if (sb.magic != 0x4D565346) {
+        fprintf(stderr, "Error: Invalid filesystem magic number\n");
+        fclose(input_fp);
+        return 1;
+    }
+    
+    if (!journal_geometry_valid(&sb)) {
+        fprintf(stderr, "Error: Invalid journal geometry in superblock\n");
+        fclose(input_fp);
+        return 1;
+    }
+    
+    if (in_place && sb.journal_blocks == 0) {
+        fprintf(stderr, "Error: Image has no journal; use --input/--output or rebuild it with --journal-blocks\n");
+        fclose(input_fp);
+        return 1;
+    }
+    
+    // A committed transaction may still be waiting to be checkpointed. In place
+    // it is replayed now; copy mode opens the input read-only, so it refuses.
+    uint64_t seq = 1;
+    if (in_place) {
+        if (journal_recover(input_fp, &sb, &seq) != 0) {
+            fclose(input_fp);
+            return 1;
+        }
+        fseek(input_fp, 0, SEEK_SET);
+        if (fread(&sb, 1, sizeof(sb), input_fp) != sizeof(sb)) {
+            fprintf(stderr, "Error reading superblock\n");
+            fclose(input_fp);
+            return 1;
+        }
+        if (!journal_geometry_valid(&sb)) {
+            fprintf(stderr, "Error: Invalid journal geometry in superblock\n");
+            fclose(input_fp);
+            return 1;
+        }
+    } else if (sb.journal_blocks != 0) {
+        journal_desc_t desc;
+        if (read_block(input_fp, sb.journal_start, (uint8_t *)&desc) != 0) {
+            fclose(input_fp);
+            return 1;
+        }
+        if (desc.magic == JOURNAL_DESC_MAGIC) {
+            fprintf(stderr, "Error: Input image needs journal recovery; run %s --image %s first\n",
+                    argv[0], input_name);
+            fclose(input_fp);
+            return 1;
+        }
+    }
+    
+    fseek(input_fp, 0, SEEK_END);
+    long image_size = ftell(input_fp);
+    fseek(input_fp, 0, SEEK_SET);
+    
+    uint8_t *fs_image = malloc(image_size);
+    if (!fs_image) {
+        fprintf(stderr, "Error: Cannot allocate memory for filesystem image\n");
+        fclose(input_fp);
+        return 1;
+    }
+    
+    if (fread(fs_image, 1, image_size, input_fp) != (size_t)image_size) {
+        fprintf(stderr, "Error reading filesystem image\n");
+        free(fs_image);
+        fclose(input_fp);
+        return 1;
+    }
+    
+    block_set_t *meta = calloc(1, sizeof(block_set_t));
+    block_set_t *data = calloc(1, sizeof(block_set_t));
+    if (!meta || !data) {
+        fprintf(stderr, "Error: Cannot allocate memory for filesystem image\n");
+        free(meta);
+        free(data);
+        free(fs_image);
+        fclose(input_fp);
+        return 1;
+    }
+    
+    // All files go into the in-memory image first; nothing reaches disk unless
+    // every add succeeds.
+    time_t now = time(NULL);
+    for (int i = 0; i < file_count; i++) {
+        if (add_file(fs_image, &sb, file_names[i], now, meta, data) != 0) {
+            free(meta);
+            free(data);
+            free(fs_image);
+            fclose(input_fp);
+            return 1;
+        }
+    }
     
     superblock_t *sb_ptr = (superblock_t *)fs_image;
     superblock_crc_finalize(sb_ptr);
     
+    if (in_place) {
+        int status = 0;
+        if (file_count > 0) {
+            mark_dirty(meta, 0);
+            if (journal_commit(input_fp, fs_image, &sb, seq, meta, data) != 0) {
+                fprintf(stderr, "Error: Journal commit failed; the image is unchanged or will be recovered on next open\n");
+                status = 1;
+            } else {
+                printf("Journal: committed transaction %llu (%u metadata blocks, %u data blocks)\n",
+                       (unsigned long long)seq, meta->count, data->count);
+            }
+        }
+        free(meta);
+        free(data);
+        free(fs_image);
+        fclose(input_fp);
+        return status;
+    }
+    fclose(input_fp);
+    free(meta);
+    free(data);
+    
     FILE *output_fp = fopen(output_name, "wb");
     if (!output_fp) {
         fprintf(stderr, "Error: Cannot create output file %s: %s\n", output_name, strerror(errno));
@@ -388,7 +762,7 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     
-    if (fwrite(fs_image, 1, image_size, output_fp) != image_size) {
+    if (fwrite(fs_image, 1, image_size, output_fp) != (size_t)image_size) {
         fprintf(stderr, "Error writing output image\n");
         free(fs_image);
         fclose(output_fp);
@@ -398,10 +772,5 @@ int main(int argc, char *argv[]) {
     fclose(output_fp);
     free(fs_image);
     
-    printf("File '%s' successfully added to filesystem\n", basename);
-    printf("Assigned inode number: %u\n", new_inode_no);
-    printf("File size: %ld bytes\n", file_size);
-    printf("Blocks used: %u\n", (uint32_t)blocks_needed);
-    
     return 0;
-}
\ No newline at end of file
+}
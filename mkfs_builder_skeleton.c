@@ -36,9 +36,11 @@ typedef struct {
     uint64_t mtime_epoch;        // Build time
     uint32_t flags;              // 0
     uint32_t checksum;           // crc32(superblock[0..4091])
+    uint64_t journal_start;      // first journal block, 0 if none
+    uint64_t journal_blocks;     // 0 if none
 } superblock_t;
 #pragma pack(pop)
-_Static_assert(sizeof(superblock_t) == 116, "superblock must fit in one block");
+_Static_assert(sizeof(superblock_t) == 132, "superblock must fit in one block");
 
 #pragma pack(push,1)
 typedef struct {
@@ -124,7 +126,7 @@ void dirent_checksum_finalize(dirent64_t* de) {
 }
 
 void print_usage(const char* prog_name) {
-    fprintf(stderr, "Usage: %s --image <filename> --size-kib <180..4096> --inodes <128..512>\n", prog_name);
+    fprintf(stderr, "Usage: %s --image <filename> --size-kib <180..4096> --inodes <128..512> [--journal-blocks <0|8..64>]\n", prog_name);
 }
 
 int main(int argc, char *argv[]) {
@@ -133,11 +135,13 @@ int main(int argc, char *argv[]) {
     char *image_name = NULL;
     uint64_t size_kib = 0;
     uint64_t inode_count = 0;
+    uint64_t journal_blocks = 0;
     
     struct option long_options[] = {
         {"image", required_argument, 0, 'i'},
         {"size-kib", required_argument, 0, 's'},
         {"inodes", required_argument, 0, 'n'},
+        {"journal-blocks", required_argument, 0, 'j'},
         {0, 0, 0, 0}
     };
     
@@ -153,6 +157,9 @@ int main(int argc, char *argv[]) {
             case 'n':
                 inode_count = strtoull(optarg, NULL, 10);
                 break;
+            case 'j':
+                journal_blocks = strtoull(optarg, NULL, 10);
+                break;
             default:
                 print_usage(argv[0]);
                 return 1;
@@ -175,11 +182,17 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     
+    // descriptor + commit record + the up to 6 metadata blocks one add changes
+    if (journal_blocks != 0 && (journal_blocks < 8 || journal_blocks > 64)) {
+        fprintf(stderr, "Error: journal-blocks must be 0 or between 8-64\n");
+        return 1;
+    }
+    
 
     uint64_t total_blocks = (size_kib * 1024) / BS;
     uint64_t inode_table_blocks = (inode_count * INODE_SIZE + BS - 1) / BS;
     
-    uint64_t metadata_blocks = 1 + 1 + 1 + inode_table_blocks; // superblock + inode bitmap + data bitmap + inode table
+    uint64_t metadata_blocks = 1 + 1 + 1 + inode_table_blocks + journal_blocks; // superblock + inode bitmap + data bitmap + inode table + journal
     if (total_blocks <= metadata_blocks) {
         fprintf(stderr, "Error: Not enough blocks for filesystem metadata\n");
         return 1;
@@ -199,11 +212,13 @@ int main(int argc, char *argv[]) {
     sb.data_bitmap_blocks = 1;
     sb.inode_table_start = 3;
     sb.inode_table_blocks = inode_table_blocks;
-    sb.data_region_start = 3 + inode_table_blocks;
+    sb.data_region_start = 3 + inode_table_blocks + journal_blocks;
     sb.data_region_blocks = data_region_blocks;
     sb.root_inode = ROOT_INO;
     sb.mtime_epoch = time(NULL);
     sb.flags = 0;
+    sb.journal_start = journal_blocks ? 3 + inode_table_blocks : 0;
+    sb.journal_blocks = journal_blocks;
     
     inode_t root_inode = {0};
     root_inode.mode = 0040000; 
@@ -279,6 +294,15 @@ int main(int argc, char *argv[]) {
         }
     }
     
+    for (uint64_t i = 0; i < journal_blocks; i++) {
+        memset(block, 0, BS);
+        if (fwrite(block, 1, BS, fp) != BS) {
+            fprintf(stderr, "Error writing journal block %llu\n", (unsigned long long)i);
+            fclose(fp);
+            return 1;
+        }
+    }
+    
     for (uint64_t i = 0; i < data_region_blocks; i++) {
         memset(block, 0, BS);
         if (i == 0) {
@@ -299,6 +323,7 @@ int main(int argc, char *argv[]) {
     printf("Total blocks: %llu\n", (unsigned long long)total_blocks);
     printf("Inode count: %llu\n", (unsigned long long)inode_count);
     printf("Data blocks: %llu\n", (unsigned long long)data_region_blocks);
+    printf("Journal blocks: %llu\n", (unsigned long long)journal_blocks);
     
     return 0;
 }
\ No newline at end of file
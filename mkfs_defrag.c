@@ -0,0 +1,736 @@
+// Build: gcc -O2 -std=c17 -Wall -Wextra mkfs_defrag.c -o mkfs_defrag
+#define _FILE_OFFSET_BITS 64
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#define BS 4096u
+#define INODE_SIZE 128u
+#define ROOT_INO 1u
+#define DIRECT_MAX 12
+#define JOURNAL_DESC_MAGIC 0x4D564A44u  // "MVJD", see mkfs_adder
+#define JOURNAL_MIN_BLOCKS 8
+
+#pragma pack(push, 1)
+typedef struct {
+    uint32_t magic;              // 0x4D565346
+    uint32_t version;            // 1
+    uint32_t block_size;         // 4096
+    uint64_t total_blocks;
+    uint64_t inode_count;
+    uint64_t inode_bitmap_start;
+    uint64_t inode_bitmap_blocks;
+    uint64_t data_bitmap_start;
+    uint64_t data_bitmap_blocks;
+    uint64_t inode_table_start;
+    uint64_t inode_table_blocks;
+    uint64_t data_region_start;
+    uint64_t data_region_blocks;
+    uint64_t root_inode;         // 1
+    uint64_t mtime_epoch;        // Build time
+    uint32_t flags;              // 0
+    uint32_t checksum;           // crc32(superblock[0..4091])
+    uint64_t journal_start;      // first journal block, 0 if none
+    uint64_t journal_blocks;     // 0 if none
+} superblock_t;
+#pragma pack(pop)
+_Static_assert(sizeof(superblock_t) == 132, "superblock must fit in one block");
+
+#pragma pack(push,1)
+typedef struct {
+    uint16_t mode;
+    uint16_t links;
+    uint32_t uid;
+    uint32_t gid;
+    uint64_t size_bytes;
+    uint64_t atime;
+    uint64_t mtime;
+    uint64_t ctime;
+    uint32_t direct[DIRECT_MAX];
+    uint32_t reserved_0;
+    uint32_t reserved_1;
+    uint32_t reserved_2;
+    uint32_t proj_id;
+    uint32_t uid16_gid16;
+    uint64_t xattr_ptr;
+    uint64_t inode_crc;          // low 4 bytes store crc32 of bytes [0..119]; high 4 bytes 0
+} inode_t;
+#pragma pack(pop)
+_Static_assert(sizeof(inode_t)==INODE_SIZE, "inode size mismatch");
+
+#pragma pack(push,1)
+typedef struct {
+    uint32_t inode_no;
+    uint8_t  type;               // 1=file, 2=dir
+    char     name[58];
+    uint8_t  checksum;           // XOR of bytes 0..62
+} dirent64_t;
+#pragma pack(pop)
+_Static_assert(sizeof(dirent64_t)==64, "dirent size mismatch");
+
+
+// ==========================DO NOT CHANGE THIS PORTION=========================
+// These functions are there for your help. You should refer to the specifications to see how you can use them.
+// ====================================CRC32====================================
+uint32_t CRC32_TAB[256];
+void crc32_init(void){
+    for (uint32_t i=0;i<256;i++){
+        uint32_t c=i;
+        for(int j=0;j<8;j++) c = (c&1)?(0xEDB88320u^(c>>1)):(c>>1);
+        CRC32_TAB[i]=c;
+    }
+}
+uint32_t crc32(const void* data, size_t n){
+    const uint8_t* p=(const uint8_t*)data; uint32_t c=0xFFFFFFFFu;
+    for(size_t i=0;i<n;i++) c = CRC32_TAB[(c^p[i])&0xFF] ^ (c>>8);
+    return c ^ 0xFFFFFFFFu;
+}
+// ====================================CRC32====================================
+
+// WARNING: CALL THIS ONLY AFTER ALL OTHER SUPERBLOCK ELEMENTS HAVE BEEN FINALIZED
+void inode_crc_finalize(inode_t* ino){
+    uint8_t tmp[INODE_SIZE]; memcpy(tmp, ino, INODE_SIZE);
+    // zero crc area before computing
+    memset(&tmp[120], 0, 8);
+    uint32_t c = crc32(tmp, 120);
+    (*ino).inode_crc = (uint64_t)c; // low 4 bytes carry the crc
+}
+
+void print_usage(const char* prog_name) {
+    fprintf(stderr, "Usage: %s --image <filename> [--dir-order] [--dry-run]\n", prog_name);
+}
+
+// One inode that owns data blocks, in the order it will be laid out.
+typedef struct {
+    uint32_t ino;
+    uint32_t nblocks;
+    uint32_t first_block;
+} defrag_file_t;
+
+// A single data block relocation: direct[idx] of inode ino moves from src to dst.
+typedef struct {
+    uint32_t ino;
+    uint32_t idx;
+    uint32_t src;
+    uint32_t dst;
+} block_move_t;
+
+// Shared state for one defragmentation run. The whole image is held in memory
+// and every block that changes is written back individually through fp.
+typedef struct {
+    FILE *fp;                    // NULL in --dry-run mode
+    uint8_t *fs_image;
+    superblock_t sb;
+    uint8_t *inode_bitmap;
+    uint8_t *data_bitmap;
+    uint8_t *inode_table;
+    uint32_t *owner_ino;         // per data block: owning inode, 0 if unreferenced
+    uint8_t *owner_idx;          // per data block: index into owner's direct[]
+} defrag_ctx_t;
+
+// Bit indices are 1-based, matching mkfs_adder.
+int test_bit(const uint8_t *bitmap, uint32_t bit_index) {
+    return (bitmap[(bit_index - 1) / 8] >> ((bit_index - 1) % 8)) & 1;
+}
+
+void set_bit(uint8_t *bitmap, uint32_t bit_index) {
+    bitmap[(bit_index - 1) / 8] |= (1 << ((bit_index - 1) % 8));
+}
+
+void clear_bit(uint8_t *bitmap, uint32_t bit_index) {
+    bitmap[(bit_index - 1) / 8] &= ~(1 << ((bit_index - 1) % 8));
+}
+
+// The journal must be absent (both fields 0) or lie between the inode table
+// and the data region, with room for a descriptor, a commit record and the
+// logged blocks. Checked on open, before any journal block is read.
+static int journal_geometry_valid(const superblock_t *sb) {
+    if (sb->journal_start == 0 && sb->journal_blocks == 0) {
+        return 1;
+    }
+    return sb->journal_blocks >= JOURNAL_MIN_BLOCKS &&
+           sb->journal_start >= sb->inode_table_start + sb->inode_table_blocks &&
+           sb->journal_start <= sb->data_region_start &&
+           sb->journal_blocks <= sb->data_region_start - sb->journal_start &&
+           sb->data_region_start <= sb->total_blocks;
+}
+
+static inode_t *get_inode(defrag_ctx_t *ctx, uint32_t ino) {
+    return (inode_t *)(ctx->inode_table + (uint64_t)(ino - 1) * INODE_SIZE);
+}
+
+static uint32_t data_bit(const defrag_ctx_t *ctx, uint32_t block) {
+    return block - (uint32_t)ctx->sb.data_region_start + 1;
+}
+
+static int block_used(const defrag_ctx_t *ctx, uint32_t block) {
+    return test_bit(ctx->data_bitmap, data_bit(ctx, block));
+}
+
+static int write_block(defrag_ctx_t *ctx, uint64_t block) {
+    if (!ctx->fp) {
+        return 0;
+    }
+    if (fseeko(ctx->fp, (off_t)(block * BS), SEEK_SET) != 0 ||
+        fwrite(ctx->fs_image + block * BS, 1, BS, ctx->fp) != BS) {
+        fprintf(stderr, "Error writing block %llu: %s\n", (unsigned long long)block, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// Everything written so far must be on disk before the next phase starts.
+static int sync_image(defrag_ctx_t *ctx) {
+    if (!ctx->fp) {
+        return 0;
+    }
+    if (fflush(ctx->fp) != 0 || fsync(fileno(ctx->fp)) != 0) {
+        fprintf(stderr, "Error syncing image: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static int write_data_bitmap(defrag_ctx_t *ctx) {
+    for (uint64_t i = 0; i < ctx->sb.data_bitmap_blocks; i++) {
+        if (write_block(ctx, ctx->sb.data_bitmap_start + i) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int write_inode(defrag_ctx_t *ctx, uint32_t ino) {
+    uint64_t offset = (uint64_t)(ino - 1) * INODE_SIZE;
+    return write_block(ctx, ctx->sb.inode_table_start + offset / BS);
+}
+
+// Applies a batch of relocations in four synced phases so that no live block
+// is ever overwritten and the image stays consistent if interrupted:
+//   1. copy each src into its (free) dst
+//   2. mark every dst used in the data bitmap
+//   3. repoint the owning inodes at dst and refresh their CRCs
+//   4. release every src in the data bitmap
+// A crash after phase 2 or 3 can at worst leak blocks; no data is lost.
+static int commit_moves(defrag_ctx_t *ctx, const block_move_t *moves, uint32_t count) {
+    if (count == 0) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(ctx->fs_image + (uint64_t)moves[i].dst * BS,
+               ctx->fs_image + (uint64_t)moves[i].src * BS, BS);
+        if (write_block(ctx, moves[i].dst) != 0) {
+            return -1;
+        }
+    }
+    if (sync_image(ctx) != 0) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        set_bit(ctx->data_bitmap, data_bit(ctx, moves[i].dst));
+    }
+    if (write_data_bitmap(ctx) != 0 || sync_image(ctx) != 0) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        inode_t *inode = get_inode(ctx, moves[i].ino);
+        (*inode).direct[moves[i].idx] = moves[i].dst;
+        inode_crc_finalize(inode);
+        if (write_inode(ctx, moves[i].ino) != 0) {
+            return -1;
+        }
+    }
+    if (sync_image(ctx) != 0) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        clear_bit(ctx->data_bitmap, data_bit(ctx, moves[i].src));
+        uint32_t s = moves[i].src - (uint32_t)ctx->sb.data_region_start;
+        uint32_t d = moves[i].dst - (uint32_t)ctx->sb.data_region_start;
+        ctx->owner_ino[d] = moves[i].ino;
+        ctx->owner_idx[d] = (uint8_t)moves[i].idx;
+        ctx->owner_ino[s] = 0;
+    }
+    if (write_data_bitmap(ctx) != 0 || sync_image(ctx) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Walks every allocated inode, checks its block pointers against the data
+// bitmap and records which inode owns each data block.
+static int scan_inodes(defrag_ctx_t *ctx, defrag_file_t *files, uint32_t *file_count) {
+    uint32_t region_start = (uint32_t)ctx->sb.data_region_start;
+    uint32_t region_end = region_start + (uint32_t)ctx->sb.data_region_blocks;
+    *file_count = 0;
+
+    for (uint32_t ino = 1; ino <= ctx->sb.inode_count; ino++) {
+        if (!test_bit(ctx->inode_bitmap, ino)) {
+            continue;
+        }
+        inode_t *inode = get_inode(ctx, ino);
+        uint32_t n = 0;
+        while (n < DIRECT_MAX && (*inode).direct[n] != 0) {
+            n++;
+        }
+        for (uint32_t i = n; i < DIRECT_MAX; i++) {
+            if ((*inode).direct[i] != 0) {
+                fprintf(stderr, "Error: Inode %u has a hole in its direct pointers\n", ino);
+                return -1;
+            }
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t block = (*inode).direct[i];
+            if (block < region_start || block >= region_end) {
+                fprintf(stderr, "Error: Inode %u points outside the data region (block %u)\n", ino, block);
+                return -1;
+            }
+            if (!block_used(ctx, block)) {
+                fprintf(stderr, "Error: Inode %u uses block %u which is free in the data bitmap\n", ino, block);
+                return -1;
+            }
+            if (ctx->owner_ino[block - region_start] != 0) {
+                fprintf(stderr, "Error: Block %u is shared by inodes %u and %u\n",
+                        block, ctx->owner_ino[block - region_start], ino);
+                return -1;
+            }
+            ctx->owner_ino[block - region_start] = ino;
+            ctx->owner_idx[block - region_start] = (uint8_t)i;
+        }
+        if (n > 0) {
+            files[*file_count].ino = ino;
+            files[*file_count].nblocks = n;
+            files[*file_count].first_block = (*inode).direct[0];
+            (*file_count)++;
+        }
+    }
+    return 0;
+}
+
+static int compare_first_block(const void *a, const void *b) {
+    const defrag_file_t *fa = a;
+    const defrag_file_t *fb = b;
+    if (fa->first_block != fb->first_block) {
+        return fa->first_block < fb->first_block ? -1 : 1;
+    }
+    return 0;
+}
+
+// Reorders files so the root directory comes first, followed by its entries in
+// directory order. Inodes not reachable from the root keep physical order.
+static void order_by_directory(defrag_ctx_t *ctx, defrag_file_t *files, uint32_t file_count) {
+    defrag_file_t *ordered = malloc(file_count * sizeof(defrag_file_t));
+    uint8_t *taken = calloc(file_count, 1);
+    if (!ordered || !taken) {
+        free(ordered);
+        free(taken);
+        return; // keep physical order
+    }
+    uint32_t out = 0;
+
+    inode_t *root = get_inode(ctx, ROOT_INO);
+    uint32_t wanted[1 + DIRECT_MAX * (BS / sizeof(dirent64_t))];
+    uint32_t wanted_count = 0;
+    wanted[wanted_count++] = ROOT_INO;
+    for (int b = 0; b < DIRECT_MAX && (*root).direct[b] != 0; b++) {
+        dirent64_t *entries = (dirent64_t *)(ctx->fs_image + (uint64_t)(*root).direct[b] * BS);
+        for (uint32_t i = 0; i < BS / sizeof(dirent64_t); i++) {
+            if (entries[i].inode_no != 0 && entries[i].inode_no != ROOT_INO) {
+                wanted[wanted_count++] = entries[i].inode_no;
+            }
+        }
+    }
+
+    for (uint32_t w = 0; w < wanted_count; w++) {
+        for (uint32_t f = 0; f < file_count; f++) {
+            if (!taken[f] && files[f].ino == wanted[w]) {
+                ordered[out++] = files[f];
+                taken[f] = 1;
+                break;
+            }
+        }
+    }
+    for (uint32_t f = 0; f < file_count; f++) {
+        if (!taken[f]) {
+            ordered[out++] = files[f];
+        }
+    }
+
+    memcpy(files, ordered, file_count * sizeof(defrag_file_t));
+    free(ordered);
+    free(taken);
+}
+
+static void print_report(defrag_ctx_t *ctx, const defrag_file_t *files, uint32_t file_count, const char *label) {
+    uint32_t used = 0, fragmented = 0, extents = 0;
+    for (uint32_t f = 0; f < file_count; f++) {
+        inode_t *inode = get_inode(ctx, files[f].ino);
+        uint32_t runs = 1;
+        for (uint32_t i = 1; i < files[f].nblocks; i++) {
+            if ((*inode).direct[i] != (*inode).direct[i - 1] + 1) {
+                runs++;
+            }
+        }
+        extents += runs;
+        used += files[f].nblocks;
+        if (runs > 1) {
+            fragmented++;
+        }
+    }
+
+    uint32_t free_extents = 0, largest_free = 0, run = 0, leaked = 0;
+    uint32_t region_start = (uint32_t)ctx->sb.data_region_start;
+    for (uint32_t i = 0; i < ctx->sb.data_region_blocks; i++) {
+        if (block_used(ctx, region_start + i) && ctx->owner_ino[i] == 0) {
+            leaked++;
+        }
+        if (!block_used(ctx, region_start + i)) {
+            if (run == 0) {
+                free_extents++;
+            }
+            run++;
+            if (run > largest_free) {
+                largest_free = run;
+            }
+        } else {
+            run = 0;
+        }
+    }
+
+    printf("Fragmentation report (%s):\n", label);
+    printf("  Inodes with data: %u\n", file_count);
+    printf("  Data blocks referenced: %u of %llu\n", used, (unsigned long long)ctx->sb.data_region_blocks);
+    printf("  Fragmented inodes: %u\n", fragmented);
+    printf("  Extents: %u (ideal %u)\n", extents, file_count);
+    printf("  Free extents: %u (largest %u blocks)\n", free_extents, largest_free);
+    printf("  Leaked blocks: %u\n", leaked);
+}
+
+// Releases data blocks that are marked used but owned by no inode, typically
+// left behind by an interrupted run. Safe because main() refuses images with
+// a journal transaction still waiting to be replayed.
+static int reclaim_leaked(defrag_ctx_t *ctx) {
+    uint32_t region_start = (uint32_t)ctx->sb.data_region_start;
+    uint32_t reclaimed = 0;
+    for (uint32_t i = 0; i < ctx->sb.data_region_blocks; i++) {
+        if (block_used(ctx, region_start + i) && ctx->owner_ino[i] == 0) {
+            clear_bit(ctx->data_bitmap, data_bit(ctx, region_start + i));
+            reclaimed++;
+        }
+    }
+    if (reclaimed == 0) {
+        return 0;
+    }
+    if (write_data_bitmap(ctx) != 0 || sync_image(ctx) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// First free data block at or after *scan that lies outside [lo, hi).
+static uint32_t next_free_outside(defrag_ctx_t *ctx, uint32_t *scan, uint32_t lo, uint32_t hi) {
+    uint32_t region_end = (uint32_t)(ctx->sb.data_region_start + ctx->sb.data_region_blocks);
+    for (; *scan < region_end; (*scan)++) {
+        if (*scan >= lo && *scan < hi) {
+            continue;
+        }
+        if (!block_used(ctx, *scan)) {
+            return (*scan)++;
+        }
+    }
+    return 0;
+}
+
+// Appends the move that pulls direct[idx] of ino into dst.
+static void add_own_move(defrag_ctx_t *ctx, block_move_t *moves, uint32_t *count,
+                         uint32_t ino, uint32_t idx, uint32_t dst) {
+    moves[*count].ino = ino;
+    moves[*count].idx = idx;
+    moves[*count].src = (*get_inode(ctx, ino)).direct[idx];
+    moves[*count].dst = dst;
+    (*count)++;
+}
+
+// Checks what occupies target block; returns 1 if it must be evicted and
+// fills *move with its owner, 0 if it is free or already correct.
+static int plan_eviction(defrag_ctx_t *ctx, uint32_t ino, uint32_t idx, uint32_t block, block_move_t *move) {
+    uint32_t region_start = (uint32_t)ctx->sb.data_region_start;
+    if (!block_used(ctx, block)) {
+        return 0;
+    }
+    uint32_t owner = ctx->owner_ino[block - region_start];
+    uint32_t owner_idx = ctx->owner_idx[block - region_start];
+    if (owner == ino && owner_idx == idx) {
+        return 0;
+    }
+    (*move).ino = owner;
+    (*move).idx = owner_idx;
+    (*move).src = block;
+    return 1;
+}
+
+// Moves a file into [cursor, cursor+n) with two batched commits: one that
+// evicts every foreign block from the run, one that copies the file in.
+// Returns 1 without touching the image if there is no room to evict into.
+static int place_batched(defrag_ctx_t *ctx, uint32_t ino, uint32_t n, uint32_t cursor, uint32_t *moved_blocks) {
+    block_move_t moves[DIRECT_MAX];
+    uint32_t count = 0;
+    uint32_t scan = (uint32_t)ctx->sb.data_region_start;
+
+    for (uint32_t i = 0; i < n; i++) {
+        if (!plan_eviction(ctx, ino, i, cursor + i, &moves[count])) {
+            continue;
+        }
+        moves[count].dst = next_free_outside(ctx, &scan, cursor, cursor + n);
+        if (moves[count].dst == 0) {
+            return 1;
+        }
+        count++;
+    }
+    if (commit_moves(ctx, moves, count) != 0) {
+        return -1;
+    }
+    *moved_blocks += count;
+
+    inode_t *inode = get_inode(ctx, ino);
+    count = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if ((*inode).direct[i] != cursor + i) {
+            add_own_move(ctx, moves, &count, ino, i, cursor + i);
+        }
+    }
+    if (commit_moves(ctx, moves, count) != 0) {
+        return -1;
+    }
+    *moved_blocks += count;
+    return 0;
+}
+
+// Fallback for nearly full images: fills the run one block at a time so a
+// single free block is enough to make progress. Returns 1 if even that fails.
+static int place_stepwise(defrag_ctx_t *ctx, uint32_t ino, uint32_t n, uint32_t cursor, uint32_t *moved_blocks) {
+    inode_t *inode = get_inode(ctx, ino);
+
+    for (uint32_t i = 0; i < n; i++) {
+        if ((*inode).direct[i] == cursor + i) {
+            continue;
+        }
+        block_move_t move;
+        if (plan_eviction(ctx, ino, i, cursor + i, &move)) {
+            uint32_t scan = (uint32_t)ctx->sb.data_region_start;
+            move.dst = next_free_outside(ctx, &scan, cursor, cursor + n);
+            if (move.dst == 0) {
+                scan = (uint32_t)ctx->sb.data_region_start;
+                move.dst = next_free_outside(ctx, &scan, cursor, cursor + i + 1);
+            }
+            if (move.dst == 0) {
+                return 1;
+            }
+            if (commit_moves(ctx, &move, 1) != 0) {
+                return -1;
+            }
+            (*moved_blocks)++;
+        }
+
+        uint32_t count = 0;
+        add_own_move(ctx, &move, &count, ino, i, cursor + i);
+        if (commit_moves(ctx, &move, 1) != 0) {
+            return -1;
+        }
+        (*moved_blocks)++;
+    }
+    return 0;
+}
+
+// Lays files out back to back from the start of the data region. For each
+// file the target run is first cleared by evicting foreign blocks elsewhere,
+// then the file's own blocks are copied into place.
+static int compact(defrag_ctx_t *ctx, const defrag_file_t *files, uint32_t file_count,
+                   uint32_t *moved_blocks, uint32_t *moved_files) {
+    uint32_t cursor = (uint32_t)ctx->sb.data_region_start;
+    *moved_blocks = 0;
+    *moved_files = 0;
+
+    for (uint32_t f = 0; f < file_count; f++) {
+        uint32_t ino = files[f].ino;
+        uint32_t n = files[f].nblocks;
+        inode_t *inode = get_inode(ctx, ino);
+
+        int in_place = 1;
+        for (uint32_t i = 0; i < n; i++) {
+            if ((*inode).direct[i] != cursor + i) {
+                in_place = 0;
+                break;
+            }
+        }
+        if (in_place) {
+            cursor += n;
+            continue;
+        }
+
+        int rc = place_batched(ctx, ino, n, cursor, moved_blocks);
+        if (rc == 1) {
+            rc = place_stepwise(ctx, ino, n, cursor, moved_blocks);
+        }
+        if (rc < 0) {
+            return -1;
+        }
+        if (rc == 1) {
+            fprintf(stderr, "Warning: Not enough free blocks to relocate inode %u; stopping early\n", ino);
+            return 0;
+        }
+        (*moved_files)++;
+        cursor += n;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    crc32_init();
+
+    char *image_name = NULL;
+    int dir_order = 0;
+    int dry_run = 0;
+
+    struct option long_options[] = {
+        {"image", required_argument, 0, 'i'},
+        {"dir-order", no_argument, 0, 'd'},
+        {"dry-run", no_argument, 0, 'n'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'i':
+                image_name = optarg;
+                break;
+            case 'd':
+                dir_order = 1;
+                break;
+            case 'n':
+                dry_run = 1;
+                break;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (!image_name) {
+        fprintf(stderr, "Error: Missing required arguments\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    FILE *fp = fopen(image_name, dry_run ? "rb" : "r+b");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot open image %s: %s\n", image_name, strerror(errno));
+        return 1;
+    }
+
+    defrag_ctx_t ctx = {0};
+    if (fread(&ctx.sb, 1, sizeof(ctx.sb), fp) != sizeof(ctx.sb)) {
+        fprintf(stderr, "Error reading superblock\n");
+        fclose(fp);
+        return 1;
+    }
+
+    if (ctx.sb.magic != 0x4D565346 || ctx.sb.block_size != BS) {
+        fprintf(stderr, "Error: Invalid filesystem magic number\n");
+        fclose(fp);
+        return 1;
+    }
+
+    if (!journal_geometry_valid(&ctx.sb)) {
+        fprintf(stderr, "Error: Invalid journal geometry in superblock\n");
+        fclose(fp);
+        return 1;
+    }
+
+    uint64_t image_size = ctx.sb.total_blocks * BS;
+    ctx.fs_image = malloc(image_size);
+    ctx.owner_ino = calloc(ctx.sb.data_region_blocks, sizeof(uint32_t));
+    ctx.owner_idx = calloc(ctx.sb.data_region_blocks, sizeof(uint8_t));
+    defrag_file_t *files = malloc(ctx.sb.inode_count * sizeof(defrag_file_t));
+    if (!ctx.fs_image || !ctx.owner_ino || !ctx.owner_idx || !files) {
+        fprintf(stderr, "Error: Cannot allocate memory for filesystem image\n");
+        free(ctx.fs_image);
+        free(ctx.owner_ino);
+        free(ctx.owner_idx);
+        free(files);
+        fclose(fp);
+        return 1;
+    }
+
+    fseeko(fp, 0, SEEK_SET);
+    if (fread(ctx.fs_image, 1, image_size, fp) != image_size) {
+        fprintf(stderr, "Error reading filesystem image\n");
+        free(ctx.fs_image);
+        free(ctx.owner_ino);
+        free(ctx.owner_idx);
+        free(files);
+        fclose(fp);
+        return 1;
+    }
+
+    // Moving blocks under a transaction that mkfs_adder has yet to replay
+    // would let the replay overwrite the new layout.
+    if (ctx.sb.journal_blocks != 0 &&
+        *(uint32_t *)(ctx.fs_image + ctx.sb.journal_start * BS) == JOURNAL_DESC_MAGIC) {
+        fprintf(stderr, "Error: Image needs journal recovery; run mkfs_adder --image %s first\n", image_name);
+        free(ctx.fs_image);
+        free(ctx.owner_ino);
+        free(ctx.owner_idx);
+        free(files);
+        fclose(fp);
+        return 1;
+    }
+
+    ctx.fp = dry_run ? NULL : fp;
+    ctx.inode_bitmap = ctx.fs_image + ctx.sb.inode_bitmap_start * BS;
+    ctx.data_bitmap = ctx.fs_image + ctx.sb.data_bitmap_start * BS;
+    ctx.inode_table = ctx.fs_image + ctx.sb.inode_table_start * BS;
+
+    int status = 0;
+    uint32_t file_count = 0;
+    if (scan_inodes(&ctx, files, &file_count) != 0) {
+        status = 1;
+    } else {
+        qsort(files, file_count, sizeof(defrag_file_t), compare_first_block);
+        if (dir_order) {
+            order_by_directory(&ctx, files, file_count);
+        }
+
+        print_report(&ctx, files, file_count, "before");
+
+        uint32_t moved_blocks = 0, moved_files = 0;
+        if (reclaim_leaked(&ctx) != 0 ||
+            compact(&ctx, files, file_count, &moved_blocks, &moved_files) != 0) {
+            fprintf(stderr, "Error: Defragmentation interrupted; image is consistent but may leak blocks\n");
+            status = 1;
+        }
+
+        print_report(&ctx, files, file_count, dry_run ? "projected" : "after");
+        printf("%s %u block moves across %u inodes\n",
+               dry_run ? "Planned" : "Performed", moved_blocks, moved_files);
+    }
+
+    free(ctx.fs_image);
+    free(ctx.owner_ino);
+    free(ctx.owner_idx);
+    free(files);
+    fclose(fp);
+    return status;
+}